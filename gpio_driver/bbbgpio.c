@@ -11,6 +11,10 @@
 #include <linux/interrupt.h>
 #include <linux/delay.h>
 #include <linux/gpio.h>
+#include <linux/spinlock.h>
+#include <linux/bitmap.h>
+#include <linux/log2.h>
+#include <linux/ktime.h>
 
 /*
   ====================================
@@ -58,7 +62,6 @@ struct bbbgpio_device{
 	struct cdev cdev;
 	struct device *device_Ptr;
 	struct mutex io_mutex;
-	u8 is_open;
 };
 
 /*Ioctl structure. Gpio group will be 0 to 3. Value that will be read/write will be 1<<PIN_NO*/
@@ -70,6 +73,27 @@ struct bbbgpio_ioctl_struct
 	int irq_number; 
 };
 
+/*Event record returned by IOCBBBGPIOEV*/
+struct bbbgpio_event_struct
+{
+	u64 timestamp_ns;
+	u32 seq;
+	u32 line_seq;
+	u32 lost;
+	u16 gpio_number;
+	u8 level;
+	u8 edge;
+};
+
+enum bbbgpio_edge
+{
+	BBBGPIO_EDGE_FALLING=0x00,
+	BBBGPIO_EDGE_RISING,
+	BBBGPIO_EDGE_LOW,        /* Low level trigger */
+	BBBGPIO_EDGE_HIGH,       /* High level trigger */
+	BBBGPIO_EDGE_BOTH=0xFF   /* Internal only, edge taken from the sampled level */
+};
+
 enum bbbgpio_direction
 {
 	INPUT=0x00,
@@ -79,7 +103,6 @@ enum bbbgpio_direction
 static struct bbbgpio_device *bbbgpiodev_Ptr=NULL;
 static dev_t bbbgpio_dev_no;
 static struct class *bbbgpioclass_Ptr=NULL;
-static struct bbbgpio_ioctl_struct ioctl_buffer;
 unsigned long irq_flags=IRQF_TRIGGER_NONE;
 volatile int bbb_irq=-1;
 
@@ -90,25 +113,52 @@ volatile int bbb_irq=-1;
   DRIVER's RING BUFFER API
   ====================================
 */
-#define BUF_LEN 8            /* Max length of the message from the device */
+#define BUF_LEN 8            /* Default number of events kept in the event log. Must be a power of 2 */
+#define BUF_LEN_MAX 4096     /* Upper limit for IOCBBBGPIOSBL */
+#define BUF_SCAN_CHUNK 16    /* Events a filtered pop checks per lock hold */
+#define BBBGPIO_MAX_LINES 128 /* 4 gpio groups x 32 pins */
+#define BBBGPIO_ALL_LINES 0xFFFF /* gpio_number used to clear a subscriber's line filter */
 struct bbb_data_content
 {
+	u64 timestamp_ns;    /* Captured at isr entry */
+	u32 seq;             /* Global sequence, set by bbb_buffer_push */
+	u32 line_seq;        /* Per line sequence, set by bbb_buffer_push */
 	u8 data;
+	u8 edge;
 	u16 dev_id;
 	
 };
+/*Shared event log. Written once by the isr, read by every open file through its own cursor*/
 struct bbb_ring_buffer
 {
-	struct bbb_data_content data[BUF_LEN];
-	u8 length;
-	u8 head;
-	u8 tail;
+	struct bbb_data_content *data;
+	u32 length;          /* Number of slots in data, power of 2 */
+	u32 head;            /* Sequence of the next event to be written */
+	u32 start;           /* Sequence of the oldest event still kept */
+	u32 line_seq[BBBGPIO_MAX_LINES];
+	spinlock_t lock;
+};
+/*Subscriber state, one per open file*/
+struct bbb_reader
+{
+	u32 cursor;          /* Sequence of the next event to be read */
+	u32 lost;            /* Events overwritten before this reader got them */
+	u8 filter_enabled;
+	DECLARE_BITMAP(line_mask,BBBGPIO_MAX_LINES);
 };
 static struct bbb_ring_buffer bbb_data_buffer;
+static u8 line_trigger[BBBGPIO_MAX_LINES]; /* bbbgpio_edge requested for each line's irq */
+static u8 bbb_trigger_to_edge(unsigned long);
 static void bbb_buffer_push(struct bbb_ring_buffer *,struct bbb_data_content);
-static s8 bbb_buffer_pop(struct bbb_ring_buffer *,struct bbb_data_content *);
-static void bbb_buffer_init(struct bbb_ring_buffer *);
-static u8 bbb_buffer_empty(struct bbb_ring_buffer *);
+static s8 bbb_buffer_pop(struct bbb_ring_buffer *,struct bbb_reader *,struct bbb_data_content *);
+static int bbb_buffer_init(struct bbb_ring_buffer *,u32);
+static int bbb_buffer_resize(struct bbb_ring_buffer *,u32);
+static void bbb_buffer_free(struct bbb_ring_buffer *);
+static u32 bbb_buffer_kept(struct bbb_ring_buffer *);
+static void bbb_reader_init(struct bbb_reader *,struct bbb_ring_buffer *);
+static u8 bbb_reader_match(struct bbb_reader *,u16);
+static void bbb_reader_filter(struct bbb_ring_buffer *,struct bbb_reader *,u16,u8);
+static u32 bbb_reader_take_lost(struct bbb_ring_buffer *,struct bbb_reader *);
 
 
 
@@ -132,6 +182,9 @@ static u8 bbb_buffer_empty(struct bbb_ring_buffer *);
 #define IOCBBBGPIOSFE      _IOW(_IOCTL_MAGIC,9,struct bbbgpio_ioctl*)      /*set falling edge*/
 #define IOCBBBGPIOSIN      _IOW(_IOCTL_MAGIC,10,struct bbbgpio_ioctl*)      /*enable gpio interrupt*/
 #define IOCBBBGPIOSBW      _IOW(_IOCTL_MAGIC,11,struct bbbgpio_ioctl*)      /*enable gpio busy wait mode*/ 
+#define IOCBBBGPIOSF       _IOW(_IOCTL_MAGIC,12,struct bbbgpio_ioctl*)      /*add/remove line from event filter*/
+#define IOCBBBGPIOEV       _IOR(_IOCTL_MAGIC,13,struct bbbgpio_event_struct*) /*read timestamped event record*/
+#define IOCBBBGPIOSBL      _IO(_IOCTL_MAGIC,14)                                /*set event log length, passed by value*/
 
 /*
   ====================================
@@ -157,17 +210,15 @@ struct file_operations fops=
 static int 
 bbbgpio_open(struct inode *inode,struct file *file)
 {
+	struct bbb_reader *reader;
 	driver_info("%s:Open\n",DEVICE_NAME);
-	if (mutex_trylock(&bbbgpiodev_Ptr->io_mutex) == 0) {
-		driver_err("%s:Mutex not free!\n",DEVICE_NAME);
-		return -EBUSY;
+	reader=kmalloc(sizeof(struct bbb_reader),GFP_KERNEL);
+	if (reader == NULL) {
+		driver_err("%s:Failed to alloc memory for reader\n",DEVICE_NAME);
+		return -ENOMEM;
 	}
-	if (bbbgpiodev_Ptr->is_open == 1) {
-		driver_err("%s:already open\n",DEVICE_NAME);
-		return -EBUSY;
-	}
-	bbbgpiodev_Ptr->is_open=1;
-	mutex_unlock(&bbbgpiodev_Ptr->io_mutex);
+	bbb_reader_init(reader,&bbb_data_buffer);
+	file->private_data=reader;
 	driver_info("%s:Driver Open successfully!\n",DEVICE_NAME);
 	return 0;     
 }
@@ -176,9 +227,8 @@ static int
 bbbgpio_release(struct inode *inode,struct file *file)
 {
 	driver_info("%s:Close\n",DEVICE_NAME);
-	mutex_lock(&bbbgpiodev_Ptr->io_mutex);
-	bbbgpiodev_Ptr->is_open=0;
-	mutex_unlock(&bbbgpiodev_Ptr->io_mutex);
+	kfree(file->private_data);
+	file->private_data=NULL;
 	return 0;
 }
 
@@ -187,25 +237,84 @@ bbbgpio_ioctl(struct file *file, unsigned int ioctl_num ,unsigned long ioctl_par
 {
 	
 	struct bbbgpio_ioctl_struct __user *p_bbbgpio_user_ioctl;
+	struct bbbgpio_ioctl_struct ioctl_buffer;
+	struct bbb_reader *reader=file->private_data;
 	long error_code;
 	struct bbb_data_content data;
+	struct bbbgpio_event_struct event;
 	driver_info("%s:Ioctl\n",DEVICE_NAME);
 	memset(&data,0,sizeof(struct bbb_data_content));
+	memset(&event,0,sizeof(struct bbbgpio_event_struct));
 	memset(&ioctl_buffer,0,sizeof(struct bbbgpio_ioctl_struct));
 	if (bbbgpiodev_Ptr == NULL) {
 		driver_err("%s:Device not found!\n",DEVICE_NAME);
 		return -ENODEV;
 	}
-	if (mutex_trylock(&bbbgpiodev_Ptr->io_mutex) == 0) {
-		driver_err("%s:Mutex not free!\n",DEVICE_NAME);
-		return -EBUSY;
+	/*These ioctls don't carry a bbbgpio_ioctl_struct. The event log has its own lock*/
+	switch (ioctl_num) {
+	case IOCBBBGPIOEV:
+	{
+		/*Overrun is reported through event.lost, retry until the reader is back in the log*/
+		do {
+			error_code=bbb_buffer_pop(&bbb_data_buffer,reader,&data);
+		} while (error_code == -EOVERFLOW);
+		if (error_code != 0)
+			return error_code;
+		event.timestamp_ns=data.timestamp_ns;
+		event.seq=data.seq;
+		event.line_seq=data.line_seq;
+		event.lost=bbb_reader_take_lost(&bbb_data_buffer,reader);
+		event.gpio_number=data.dev_id;
+		event.level=data.data;
+		event.edge=data.edge;
+		if (copy_to_user((struct bbbgpio_event_struct __user*)ioctl_param,&event,sizeof(struct bbbgpio_event_struct)) != 0) {
+			driver_err("\t%s:Cout not write values to user!\n",DEVICE_NAME);
+			return -EINVAL;
+		}
+		return 0;
+	}
+	case IOCBBBGPIOSBL:
+		return bbb_buffer_resize(&bbb_data_buffer,(u32)ioctl_param);
+	default:
+		break;
 	}
 	p_bbbgpio_user_ioctl=(struct bbbgpio_ioctl_struct __user*)ioctl_param;
 	if (copy_from_user(&ioctl_buffer,p_bbbgpio_user_ioctl,sizeof(struct bbbgpio_ioctl_struct)) != 0) {
 		driver_err("%s:Could not copy data from userspace!\n",DEVICE_NAME);
-		mutex_unlock(&bbbgpiodev_Ptr->io_mutex);
 		return -EINVAL;
 	}
+	/*Event log ioctls, no need for the device mutex*/
+	switch (ioctl_num) {
+	case IOCBBBGPIORD:
+	{
+		error_code=bbb_buffer_pop(&bbb_data_buffer,reader,&data);
+		if (error_code != 0) {
+			/*-EAGAIN when no event is pending, -EOVERFLOW once after events were overwritten*/
+			if (error_code == -EOVERFLOW)
+				bbb_reader_take_lost(&bbb_data_buffer,reader); /*Loss reported, don't count it again on IOCBBBGPIOEV*/
+			return error_code;
+		}
+		ioctl_buffer.gpio_number=data.dev_id;
+		ioctl_buffer.read_buffer=data.data;
+		if (copy_to_user(p_bbbgpio_user_ioctl,&ioctl_buffer,sizeof(struct bbbgpio_ioctl_struct)) != 0) {
+			driver_err("\t%s:Cout not write values to user!\n",DEVICE_NAME);
+			return -EINVAL;
+		}
+		return 0;
+	}
+	case IOCBBBGPIOSF:
+	{
+		if (ioctl_buffer.gpio_number != BBBGPIO_ALL_LINES && ioctl_buffer.gpio_number >= BBBGPIO_MAX_LINES)
+			return -EINVAL;
+		bbb_reader_filter(&bbb_data_buffer,reader,ioctl_buffer.gpio_number,ioctl_buffer.write_buffer);
+		return 0;
+	}
+	default:
+		break;
+	}
+	/*Gpio and irq configuration ioctls*/
+	if (mutex_lock_interruptible(&bbbgpiodev_Ptr->io_mutex) != 0)
+		return -ERESTARTSYS;
 	switch (ioctl_num) {
 	case IOCBBBGPIORP:
 	{
@@ -226,23 +335,6 @@ bbbgpio_ioctl(struct file *file, unsigned int ioctl_num ,unsigned long ioctl_par
 		mutex_unlock(&bbbgpiodev_Ptr->io_mutex);
 		break;
 	}
-	case IOCBBBGPIORD:
-	{
-		if (bbb_buffer_empty(&bbb_data_buffer) == 1) {
-			mutex_unlock(&bbbgpiodev_Ptr->io_mutex);
-			return -EAGAIN;
-		}
-		bbb_buffer_pop(&bbb_data_buffer,&data);
-		ioctl_buffer.gpio_number=data.dev_id;
-		ioctl_buffer.read_buffer=data.data;
-		if (copy_to_user(p_bbbgpio_user_ioctl,&ioctl_buffer,sizeof(struct bbbgpio_ioctl_struct)) != 0) {
-			driver_err("\t%s:Cout not write values to user!\n",DEVICE_NAME);
-			mutex_unlock(&bbbgpiodev_Ptr->io_mutex);
-			return -EINVAL;
-		}
-		mutex_unlock(&bbbgpiodev_Ptr->io_mutex);
-		break;
-	}
 	case IOCBBBGPIOSD:
 	{
 		if (ioctl_buffer.write_buffer == OUTPUT)
@@ -284,6 +376,9 @@ bbbgpio_ioctl(struct file *file, unsigned int ioctl_num ,unsigned long ioctl_par
 	case IOCBBBGPIOSIN:
 	{
 		bbb_irq=gpio_to_irq(ioctl_buffer.gpio_number);
+		/*Set before request_irq so the first interrupt already sees it*/
+		if (ioctl_buffer.gpio_number < BBBGPIO_MAX_LINES)
+			line_trigger[ioctl_buffer.gpio_number]=bbb_trigger_to_edge(irq_flags);
 		if (request_irq(bbb_irq,(irq_handler_t) irq_handler,irq_flags,DEVICE_NAME,(void *)ioctl_buffer.gpio_number)) {
 			driver_err("%s:can't get assigned irq %i\n",DEVICE_NAME,bbb_irq);
 			bbb_irq=-1;
@@ -318,40 +413,34 @@ bbbgpio_ioctl(struct file *file, unsigned int ioctl_num ,unsigned long ioctl_par
 static ssize_t 
 bbbgpio_read(struct file *filp,char __user *buffer,size_t length,loff_t *offset)
 {
+	struct bbbgpio_ioctl_struct ioctl_buffer;
 
-	if (mutex_trylock(&bbbgpiodev_Ptr->io_mutex) == 0) {
-		driver_err("%s:Mutex not free!\n",DEVICE_NAME);
-		return -EBUSY;  
-	}
 	if (copy_from_user(&ioctl_buffer,buffer,sizeof(struct bbbgpio_ioctl_struct)) != 0) {
 		driver_err("%s:Could not copy data from userspace!\n",DEVICE_NAME);
-		mutex_unlock(&bbbgpiodev_Ptr->io_mutex);
 		return -EINVAL;
 	}
-	
+	if (mutex_lock_interruptible(&bbbgpiodev_Ptr->io_mutex) != 0)
+		return -ERESTARTSYS;
 	ioctl_buffer.read_buffer=gpio_get_value(ioctl_buffer.gpio_number);
+	mutex_unlock(&bbbgpiodev_Ptr->io_mutex);
 	if (copy_to_user(buffer,&ioctl_buffer,sizeof(struct bbbgpio_ioctl_struct)) !=0 ) {
 		driver_err("\t%s:Cout not write values to user!\n",DEVICE_NAME);
-		mutex_unlock(&bbbgpiodev_Ptr->io_mutex);
 		return -EINVAL;
 	}
-	mutex_unlock(&bbbgpiodev_Ptr->io_mutex);
 	return 0;
 	
 }
 static ssize_t 
 bbbgpio_write(struct file *filp, const char __user *buffer, size_t length, loff_t *offset)
 {
-	if (mutex_trylock(&bbbgpiodev_Ptr->io_mutex) == 0) {
-		driver_err("%s:Mutex not free!\n",DEVICE_NAME);
-		return -EBUSY;  
-	}
-	
+	struct bbbgpio_ioctl_struct ioctl_buffer;
+
 	if (copy_from_user(&ioctl_buffer,buffer,sizeof(struct bbbgpio_ioctl_struct)) != 0) {
 		driver_err("%s:Could not copy data from userspace!\n",DEVICE_NAME);
-		mutex_unlock(&bbbgpiodev_Ptr->io_mutex);
 		return -EINVAL;
 	}
+	if (mutex_lock_interruptible(&bbbgpiodev_Ptr->io_mutex) != 0)
+		return -ERESTARTSYS;
 	gpio_set_value(ioctl_buffer.gpio_number,ioctl_buffer.write_buffer);
 	mutex_unlock(&bbbgpiodev_Ptr->io_mutex);
 	return 0;
@@ -362,52 +451,185 @@ irq_handler(int irq,void *dev_id,struct pt_regs *regs)
 {
 	u16 io_number=(u16)dev_id;
 	struct bbb_data_content content;
-	if (mutex_trylock(&bbbgpiodev_Ptr->io_mutex) == 0) {
-		driver_err("%s:Mutex not free!\n",DEVICE_NAME);
-		goto exit_interrupt;
-	}
 	
+	content.timestamp_ns=ktime_to_ns(ktime_get());
 	content.data=gpio_get_value(io_number);
+	content.edge=(io_number < BBBGPIO_MAX_LINES) ? line_trigger[io_number] : BBBGPIO_EDGE_BOTH;
+	if (content.edge == BBBGPIO_EDGE_BOTH) /*Trigger doesn't tell which edge fired*/
+		content.edge=content.data ? BBBGPIO_EDGE_RISING : BBBGPIO_EDGE_FALLING;
 	content.dev_id=io_number;
 	bbb_buffer_push(&bbb_data_buffer,content);
 	
-	mutex_unlock(&bbbgpiodev_Ptr->io_mutex);
 	driver_info("Interrup handler executed!\n");
-exit_interrupt:{
-		
-		return (irq_handler_t) IRQ_HANDLED;
-	}
+	return (irq_handler_t) IRQ_HANDLED;
 }
 
-static void 
-bbb_buffer_init(struct bbb_ring_buffer *buffer)
+static u8
+bbb_trigger_to_edge(unsigned long flags)
+{
+	switch (flags) {
+	case IRQF_TRIGGER_RISING:
+		return BBBGPIO_EDGE_RISING;
+	case IRQF_TRIGGER_FALLING:
+		return BBBGPIO_EDGE_FALLING;
+	case IRQF_TRIGGER_LOW:
+		return BBBGPIO_EDGE_LOW;
+	case IRQF_TRIGGER_HIGH:
+		return BBBGPIO_EDGE_HIGH;
+	default:
+		return BBBGPIO_EDGE_BOTH;
+	}
+}
+static int 
+bbb_buffer_init(struct bbb_ring_buffer *buffer,u32 length)
 {
 	memset(buffer,0,sizeof(struct bbb_ring_buffer));
+	spin_lock_init(&buffer->lock);
+	buffer->data=kcalloc(length,sizeof(struct bbb_data_content),GFP_KERNEL);
+	if (buffer->data == NULL)
+		return -ENOMEM;
+	buffer->length=length;
+	return 0;
+}
+static int
+bbb_buffer_resize(struct bbb_ring_buffer *buffer,u32 length)
+{
+	struct bbb_data_content *new_data;
+	struct bbb_data_content *old_data;
+	unsigned long flags;
+	u32 copied;
+	u32 seq;
+	if (length < 2 || length > BUF_LEN_MAX || !is_power_of_2(length))
+		return -EINVAL;
+	new_data=kcalloc(length,sizeof(struct bbb_data_content),GFP_KERNEL);
+	if (new_data == NULL)
+		return -ENOMEM;
+	spin_lock_irqsave(&buffer->lock,flags);
+	/*Move the newest events over, head and the readers' cursors stay valid*/
+	copied=bbb_buffer_kept(buffer);
+	if (copied > length)
+		copied=length;
+	for (seq=buffer->head-copied; seq != buffer->head; seq++)
+		new_data[seq&(length-1)]=buffer->data[seq&(buffer->length-1)];
+	old_data=buffer->data;
+	buffer->data=new_data;
+	buffer->length=length;
+	buffer->start=buffer->head-copied;
+	spin_unlock_irqrestore(&buffer->lock,flags);
+	kfree(old_data);
+	return 0;
+}
+static void
+bbb_buffer_free(struct bbb_ring_buffer *buffer)
+{
+	kfree(buffer->data);
+	buffer->data=NULL;
+	buffer->length=0;
+}
+/*Number of events still readable. Caller holds buffer->lock*/
+static u32
+bbb_buffer_kept(struct bbb_ring_buffer *buffer)
+{
+	u32 written=buffer->head-buffer->start;
+	return (written < buffer->length) ? written : buffer->length;
 }
 static void 
 bbb_buffer_push(struct bbb_ring_buffer *buffer,struct bbb_data_content data)
 {
-	buffer->data[buffer->tail]=data;
-	buffer->tail=(buffer->tail+1)%BUF_LEN;
-	if (buffer->length < BUF_LEN) 
-		buffer->length++;
-	else 
-		buffer->head=(buffer->head+1)%BUF_LEN;
+	unsigned long flags;
+	spin_lock_irqsave(&buffer->lock,flags);
+	data.seq=buffer->head;
+	data.line_seq=(data.dev_id < BBBGPIO_MAX_LINES) ? buffer->line_seq[data.dev_id]++ : 0;
+	buffer->data[buffer->head&(buffer->length-1)]=data;
+	buffer->head++;
+	/*Keep start within one ring of head so head-start can't wrap*/
+	if (buffer->head-buffer->start > buffer->length)
+		buffer->start=buffer->head-buffer->length;
+	spin_unlock_irqrestore(&buffer->lock,flags);
 }
 static s8 
-bbb_buffer_pop(struct bbb_ring_buffer *buffer,struct bbb_data_content *data)
+bbb_buffer_pop(struct bbb_ring_buffer *buffer,struct bbb_reader *reader,struct bbb_data_content *data)
 {
-	if (!buffer->length) 
-		return -1;
-	*data=buffer->data[buffer->head];
-	buffer->head=(buffer->head+1)%BUF_LEN;
-	buffer->length--;
-	return 0;
+	unsigned long flags;
+	u32 kept;
+	u32 scanned;
+	s8 status=-EAGAIN;
+	spin_lock_irqsave(&buffer->lock,flags);
+	for (;;) {
+		kept=bbb_buffer_kept(buffer);
+		if ((u32)(buffer->head-reader->cursor) > kept) {
+			/*Reader was lapped by the isr or the log was shrunk. Resync to the oldest kept event and report it*/
+			reader->lost+=buffer->head-reader->cursor-kept;
+			reader->cursor=buffer->head-kept;
+			status=-EOVERFLOW;
+			goto exit_pop;
+		}
+		for (scanned=0; scanned < BUF_SCAN_CHUNK && reader->cursor != buffer->head; scanned++) {
+			*data=buffer->data[reader->cursor&(buffer->length-1)];
+			reader->cursor++;
+			if (bbb_reader_match(reader,data->dev_id) == 1) {
+				status=0;
+				goto exit_pop;
+			}
+		}
+		if (reader->cursor == buffer->head)
+			break;
+		/*Long filter scan, let the isr in before the next chunk*/
+		spin_unlock_irqrestore(&buffer->lock,flags);
+		spin_lock_irqsave(&buffer->lock,flags);
+	}
+exit_pop:
+	spin_unlock_irqrestore(&buffer->lock,flags);
+	return status;
+}
+static void
+bbb_reader_init(struct bbb_reader *reader,struct bbb_ring_buffer *buffer)
+{
+	unsigned long flags;
+	memset(reader,0,sizeof(struct bbb_reader));
+	spin_lock_irqsave(&buffer->lock,flags);
+	/*Only events raised after open are delivered*/
+	reader->cursor=buffer->head;
+	spin_unlock_irqrestore(&buffer->lock,flags);
+}
+/*Return and clear the number of events the reader lost since the last call*/
+static u32
+bbb_reader_take_lost(struct bbb_ring_buffer *buffer,struct bbb_reader *reader)
+{
+	unsigned long flags;
+	u32 lost;
+	spin_lock_irqsave(&buffer->lock,flags);
+	lost=reader->lost;
+	reader->lost=0;
+	spin_unlock_irqrestore(&buffer->lock,flags);
+	return lost;
+}
+/*Add or remove a line from the reader's filter. BBBGPIO_ALL_LINES clears it*/
+static void
+bbb_reader_filter(struct bbb_ring_buffer *buffer,struct bbb_reader *reader,u16 gpio_number,u8 enable)
+{
+	unsigned long flags;
+	spin_lock_irqsave(&buffer->lock,flags);
+	if (gpio_number == BBBGPIO_ALL_LINES) {
+		bitmap_zero(reader->line_mask,BBBGPIO_MAX_LINES);
+		reader->filter_enabled=0;
+	} else if (enable != 0) {
+		set_bit(gpio_number,reader->line_mask);
+		reader->filter_enabled=1;
+	} else {
+		clear_bit(gpio_number,reader->line_mask);
+		reader->filter_enabled=!bitmap_empty(reader->line_mask,BBBGPIO_MAX_LINES);
+	}
+	spin_unlock_irqrestore(&buffer->lock,flags);
 }
 static u8
-bbb_buffer_empty(struct bbb_ring_buffer *buffer)
+bbb_reader_match(struct bbb_reader *reader,u16 dev_id)
 {
-	return (buffer->length == 0);
+	if (reader->filter_enabled == 0)
+		return 1;
+	if (dev_id >= BBBGPIO_MAX_LINES)
+		return 0;
+	return test_bit(dev_id,reader->line_mask) ? 1 : 0;
 }
 static int
 __init bbbgpio_init(void)
@@ -418,9 +640,13 @@ __init bbbgpio_init(void)
 		goto failed_alloc;
 	}
 	memset(bbbgpiodev_Ptr, 0,sizeof(struct bbbgpio_device));
+	if (bbb_buffer_init(&bbb_data_buffer,BUF_LEN) != 0) {
+		driver_err("%s:Failed to alloc memory for event log\n",DEVICE_NAME);
+		goto failed_register;
+	}
 	if (alloc_chrdev_region(&bbbgpio_dev_no,0,1,DEVICE_NAME) < 0) {
 		driver_err("%s:Coud not register\n",DEVICE_NAME);
-		goto failed_register;
+		goto failed_buffer;
 	}
 	bbbgpioclass_Ptr=class_create(THIS_MODULE,DEVICE_CLASS_NAME);
 	if (IS_ERR(bbbgpioclass_Ptr)) {
@@ -443,8 +669,6 @@ __init bbbgpio_init(void)
 	
 	
 	driver_info("Driver %s loaded.Build on %s %s\n",DEVICE_NAME,__DATE__,__TIME__);
-	memset(&ioctl_buffer,0,sizeof(struct bbbgpio_ioctl_struct));
-	bbb_buffer_init(&bbb_data_buffer);
 	return 0;
 failed_device_create:
 	{
@@ -460,6 +684,10 @@ failed_class_create:
 	{
 		unregister_chrdev_region(bbbgpio_dev_no,1);
 	}
+failed_buffer:
+	{
+		bbb_buffer_free(&bbb_data_buffer);
+	}
 	
 failed_register:
 	{
@@ -487,6 +715,7 @@ __exit bbbgpio_exit(void){
                 class_destroy(bbbgpioclass_Ptr);
                 bbbgpioclass_Ptr=NULL;
         }
+        bbb_buffer_free(&bbb_data_buffer);
 
         driver_info("Driver %s unloaded.Build on %s %s\n",DEVICE_NAME,__DATE__,__TIME__);
 }
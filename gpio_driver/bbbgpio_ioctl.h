@@ -10,6 +10,26 @@ struct bbbgpio_ioctl_struct
 	int irq_number; 
 };
 
+/*Event record returned by IOCBBBGPIOEV*/
+struct bbbgpio_event_struct
+{
+	u64 timestamp_ns;     /*monotonic time captured at isr entry*/
+	u32 seq;              /*global event sequence*/
+	u32 line_seq;         /*sequence of this line's events*/
+	u32 lost;             /*events overwritten before this file read them*/
+	u16 gpio_number;
+	u8 level;
+	u8 edge;              /*trigger that raised the event, one of BBBGPIO_EDGE_xxx*/
+};
+
+#define BBBGPIO_EDGE_FALLING 0
+#define BBBGPIO_EDGE_RISING 1
+#define BBBGPIO_EDGE_LOW 2     /*low level trigger*/
+#define BBBGPIO_EDGE_HIGH 3    /*high level trigger*/
+#define BBBGPIO_ALL_LINES 0xFFFF /* gpio_number for IOCBBBGPIOSF: clear filter, receive all lines */
+
+/*Interrupt events are delivered to each open file from the moment it was opened, no earlier events are replayed*/
+
 
 /*
 ====================================
@@ -28,6 +48,9 @@ DRIVER's IOCTL OPTIONS
 #define IOCBBBGPIOSFE      _IOW(_IOCTL_MAGIC,9,struct bbbgpio_ioctl*)      /*set falling edge*/
 #define IOCBBBGPIOSIN      _IOW(_IOCTL_MAGIC,10,struct bbbgpio_ioctl*)      /*enable gpio interrupt*/
 #define IOCBBBGPIOSBW      _IOW(_IOCTL_MAGIC,11,struct bbbgpio_ioctl*)      /*enable gpio busy wait mode*/ 
+#define IOCBBBGPIOSF       _IOW(_IOCTL_MAGIC,12,struct bbbgpio_ioctl*)      /*add/remove line from event filter*/
+#define IOCBBBGPIOEV       _IOR(_IOCTL_MAGIC,13,struct bbbgpio_event_struct*) /*read timestamped event record, -EAGAIN if none. Overruns only show in lost*/
+#define IOCBBBGPIOSBL      _IO(_IOCTL_MAGIC,14)                                /*set event log length, passed by value*/
 
 
 #endif
@@ -20,10 +20,12 @@ gcc test.c -o test
 #define PIN_NO_READ 27
 #define NO_OF_WRITES 10
 #define NO_OF_READS 10
+#define EVENT_LOG_LEN 64
 int main(int argc, char argv)
 {
       int fd;
       struct bbbgpio_ioctl_struct ioctl_struct;
+      struct bbbgpio_event_struct event_struct;
       int i;
       int read_value;
       int irq;
@@ -107,6 +109,11 @@ int main(int argc, char argv)
             i++;
       }
       
+      /*Keep more events than the default log length*/
+      if(ioctl(fd,IOCBBBGPIOSBL,EVENT_LOG_LEN)!=0){
+            fprintf(stderr,"IOCBBBGPIOSBL:%s\n",strerror(errno));
+            goto error;
+      }
       /*Enable interrupts*/
       ioctl_struct.gpio_number=gpio_number_read;
       if(ioctl(fd,IOCBBBGPIOSH1,&ioctl_struct)!=0){
@@ -120,11 +127,22 @@ int main(int argc, char argv)
             goto error;
       }
       irq=ioctl_struct.irq_number;
+      /*Only receive events of the read pin on this file*/
+      ioctl_struct.gpio_number=gpio_number_read;
+      ioctl_struct.write_buffer=1;
+      if(ioctl(fd,IOCBBBGPIOSF,&ioctl_struct)!=0){
+            fprintf(stderr,"IOCBBBGPIOSF:%s\n",strerror(errno));
+            goto error;
+      }
       i=0;
       while(i<NO_OF_READS){
             ioctl_struct.gpio_number=gpio_number_read;
             ioctl_struct.irq_number=irq;
             if(ioctl(fd,IOCBBBGPIORD,&ioctl_struct)!=0){
+                  if(errno==EOVERFLOW){
+                        fprintf(stderr,"IOCBBBGPIORD:events lost\n");
+                        continue;
+                  }
                   fprintf(stderr,"IOCBBBGPIORD:%s\n",strerror(errno));
                   goto error;
             }
@@ -134,6 +152,19 @@ int main(int argc, char argv)
       }
       
       
+      /*Read timestamped event records*/
+      i=0;
+      while(i<NO_OF_READS){
+            if(ioctl(fd,IOCBBBGPIOEV,&event_struct)!=0){
+                  fprintf(stderr,"IOCBBBGPIOEV:%s\n",strerror(errno));
+                  goto error;
+            }
+            printf("%llu ns seq %u line_seq %u lost %u level %u\n",(unsigned long long)event_struct.timestamp_ns,
+                   event_struct.seq,event_struct.line_seq,event_struct.lost,event_struct.level);
+            sleep(2);
+            i++;
+      }
+      
       ioctl_struct.gpio_number=gpio_number_read;
       ioctl_struct.irq_number=irq;
       printf("Irq number %i",irq);